@@ -0,0 +1,74 @@
+// directory_cache.cpp
+// Licensed under Apache 2.0
+
+#include "directory_cache.h"
+
+#include <QDir>
+#include <QtConcurrent/QtConcurrentRun>
+
+DirectoryCache::DirectoryCache(const QString& root)
+    : root(QDir::cleanPath(root)),
+      stopping(false)
+{
+    created.insert(this->root);
+}
+
+// Stops the creation pipeline; directories it has not reached yet are left for ensure() to create
+DirectoryCache::~DirectoryCache()
+{
+    stopping = true;
+    pipeline.waitForFinished();
+}
+
+// Makes sure path exists, creating it only if neither this thread nor the pipeline has done so already
+// Returns false if the directory could not be created
+bool DirectoryCache::ensure(const QString& path)
+{
+    const QString directory = QDir::cleanPath(path);
+
+    {
+        QMutexLocker locker(&mutex);
+        if (created.contains(directory)) {
+            return true;
+        }
+    }
+
+    // Not done under the lock so the copy loop is never blocked behind a slow mkpath in the pipeline
+    // mkpath succeeds if another thread created the directory first, so racing on the same path is harmless
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
+
+    markCreated(directory);
+    return true;
+}
+
+// Creates paths in order on a background thread so directories are ready before the copies that need them
+void DirectoryCache::prefetch(const QStringList& paths)
+{
+    pipeline.waitForFinished();
+    pipeline = QtConcurrent::run([this, paths] {
+        for (const QString& path : paths) {
+            if (stopping || !ensure(path)) {
+                return;
+            }
+        }
+    });
+}
+
+// Records path and its ancestors below root, since mkpath has created all of them
+void DirectoryCache::markCreated(const QString& path)
+{
+    QMutexLocker locker(&mutex);
+
+    QString directory = path;
+    while (!created.contains(directory) && directory.startsWith(root)) {
+        created.insert(directory);
+
+        const qsizetype separator = directory.lastIndexOf('/');
+        if (separator <= 0) {
+            break;
+        }
+        directory.truncate(separator);
+    }
+}
@@ -0,0 +1,33 @@
+// directory_cache.h
+// Licensed under Apache 2.0
+
+#pragma once
+
+#include <QFuture>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+// Creates destination directories at most once each; safe to share between the copy loop and the creation pipeline
+// Directories under root are remembered once created, so later files only pay for a hash lookup instead of a mkpath
+class DirectoryCache
+{
+public:
+    explicit DirectoryCache(const QString& root);
+    ~DirectoryCache();
+
+    bool ensure(const QString& path);
+    void prefetch(const QStringList& paths);
+
+private:
+    void markCreated(const QString& path);
+
+    QString root;
+    QMutex mutex;
+    QSet<QString> created;
+    QFuture<void> pipeline;
+    std::atomic_bool stopping;
+};
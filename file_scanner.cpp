@@ -0,0 +1,549 @@
+// file_scanner.cpp
+// Licensed under Apache 2.0
+
+#include "file_scanner.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStack>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Paths and names are compared case-insensitively on Windows, matching the file system
+#ifdef Q_OS_WIN
+const QRegularExpression::PatternOptions kPatternOptions = QRegularExpression::CaseInsensitiveOption;
+
+QString foldCase(const QString& value)
+{
+    return value.toCaseFolded();
+}
+#else
+const QRegularExpression::PatternOptions kPatternOptions = QRegularExpression::NoPatternOption;
+
+QString foldCase(const QString& value)
+{
+    return value;
+}
+#endif
+
+// Returns the lowercase extension of fileName including the leading '.', or an empty string if it has none
+QString suffixOf(const QString& fileName)
+{
+    const qsizetype dot = fileName.lastIndexOf('.');
+    if (dot < 0 || dot == fileName.size() - 1) {
+        return QString();
+    }
+    return fileName.mid(dot).toLower();
+}
+
+// Extensions that often hide a media file: generic containers, partial downloads and nonstandard JPEG variants
+// Files with any other extension are never sniffed, so source trees and program files are not opened
+const QSet<QString>& sniffableExtensions()
+{
+    static const QSet<QString> extensions = {
+        ".bin", ".dat", ".tmp", ".file", ".download", ".jpe", ".jfif", ".jpg_large", ".jpeg_large"
+    };
+    return extensions;
+}
+
+// Header reads run on their own pool rather than the global one, which QCoreApplication waits for on exit
+// It is never deleted, so a read stuck on a slow or disconnected drive cannot hold up shutdown
+QThreadPool* sniffPool()
+{
+    static QThreadPool* pool = new QThreadPool;
+    return pool;
+}
+
+bool hasWildcard(const QString& pattern)
+{
+    for (const QChar c : pattern) {
+        if (c == '*' || c == '?' || c == '[') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Joins the individual glob expressions into a single alternation so each entry costs one regex match
+QRegularExpression compileGlobs(const QStringList& globs)
+{
+    if (globs.isEmpty()) {
+        return QRegularExpression();
+    }
+
+    QStringList alternatives;
+    for (const QString& glob : globs) {
+        alternatives.append(QString("(?:%1)").arg(QRegularExpression::wildcardToRegularExpression(glob)));
+    }
+
+    QRegularExpression regex(alternatives.join('|'), kPatternOptions);
+    regex.optimize();
+    return regex;
+}
+
+#ifdef Q_OS_UNIX
+// Returns the device id of path, or 0 if it cannot be determined
+dev_t deviceOf(const QString& path)
+{
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return 0;
+    }
+    return info.st_dev;
+}
+#endif
+
+// Reads the requested metadata fields with a single call, asking the kernel only for those fields where statx is available
+// If identity is given, the fields identifying the file version for the signature cache are read by the same call
+// Fields that cannot be read are left unset so metadata filters reject the candidate; returns false if the file could not be read at all
+bool statCandidate(ScanCandidate& candidate, int fields, SignatureCache::Key* identity = nullptr)
+{
+    if (identity) {
+        fields |= ModifiedMetadata;
+    }
+
+#if defined(Q_OS_LINUX) && defined(STATX_BASIC_STATS)
+    unsigned int mask = 0;
+    if (fields & SizeMetadata) {
+        mask |= STATX_SIZE;
+    }
+    if (fields & ModifiedMetadata) {
+        mask |= STATX_MTIME;
+    }
+    if (identity) {
+        mask |= STATX_INO;
+    }
+
+    // AT_STATX_DONT_SYNC avoids forcing a round trip on network file systems for cached attributes
+    struct statx info;
+    if (::statx(AT_FDCWD, QFile::encodeName(candidate.path).constData(), AT_STATX_DONT_SYNC, mask, &info) != 0) {
+        return false;
+    }
+    if ((fields & SizeMetadata) && (info.stx_mask & STATX_SIZE)) {
+        candidate.size = static_cast<qint64>(info.stx_size);
+        candidate.fields |= SizeMetadata;
+    }
+    if ((fields & ModifiedMetadata) && (info.stx_mask & STATX_MTIME)) {
+        candidate.modified = static_cast<qint64>(info.stx_mtime.tv_sec) * 1000 + info.stx_mtime.tv_nsec / 1000000;
+        candidate.fields |= ModifiedMetadata;
+    }
+    if (identity) {
+        identity->device = (static_cast<quint64>(info.stx_dev_major) << 32) | info.stx_dev_minor;
+        identity->inode = static_cast<quint64>(info.stx_ino);
+        identity->modified = candidate.modified;
+    }
+#elif defined Q_OS_UNIX
+    struct stat info;
+    if (::stat(QFile::encodeName(candidate.path).constData(), &info) != 0) {
+        return false;
+    }
+    if (fields & SizeMetadata) {
+        candidate.size = static_cast<qint64>(info.st_size);
+        candidate.fields |= SizeMetadata;
+    }
+    if (fields & ModifiedMetadata) {
+        candidate.modified = static_cast<qint64>(info.st_mtime) * 1000;
+        candidate.fields |= ModifiedMetadata;
+    }
+    if (identity) {
+        identity->device = static_cast<quint64>(info.st_dev);
+        identity->inode = static_cast<quint64>(info.st_ino);
+        identity->modified = candidate.modified;
+    }
+#else
+    const QFileInfo fileInfo(candidate.path);
+    if (!fileInfo.exists()) {
+        return false;
+    }
+    if (fields & SizeMetadata) {
+        candidate.size = fileInfo.size();
+        candidate.fields |= SizeMetadata;
+    }
+    if (fields & ModifiedMetadata) {
+        candidate.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        candidate.fields |= ModifiedMetadata;
+    }
+    if (identity) {
+        identity->path = candidate.path;
+        identity->modified = candidate.modified;
+    }
+#endif
+
+    return true;
+}
+
+#ifdef Q_OS_WIN
+// Directory listings on Windows already carry size and times, so they are taken from the iterator without another call
+void copyMetadata(ScanCandidate& candidate, const QFileInfo& fileInfo, int fields)
+{
+    if (fields & SizeMetadata) {
+        candidate.size = fileInfo.size();
+        candidate.fields |= SizeMetadata;
+    }
+    if (fields & ModifiedMetadata) {
+        candidate.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        candidate.fields |= ModifiedMetadata;
+    }
+}
+#endif
+
+} // namespace
+
+ScanRules::ScanRules(const QStringList& patterns, const QString& rootDirectory)
+{
+    const QString root = QDir::cleanPath(QFileInfo(rootDirectory).absoluteFilePath());
+    rootPrefix = root.endsWith('/') ? root : root + '/';
+
+    for (const QString& rawPattern : patterns) {
+        QString pattern = QDir::fromNativeSeparators(rawPattern.trimmed());
+        if (pattern.isEmpty() || pattern.startsWith('#')) {
+            continue;
+        }
+
+        Matcher& matcher = pattern.startsWith('!') ? includes : excludes;
+        if (pattern.startsWith('!')) {
+            pattern.remove(0, 1);
+        }
+        while (pattern.size() > 1 && pattern.endsWith('/')) {
+            pattern.chop(1);
+        }
+        if (pattern.isEmpty()) {
+            continue;
+        }
+
+        if (!pattern.contains('/')) {
+            if (hasWildcard(pattern)) {
+                matcher.nameGlobs.append(pattern);
+            } else {
+                matcher.names.insert(foldCase(pattern));
+            }
+            continue;
+        }
+
+        // Wildcards are only looked for in the pattern as written, since the scan root may itself contain '[', '*' or '?'
+        // Relative globs are matched against the path below the root so the root never becomes part of a regex
+        const bool isRelative = !QDir::isAbsolutePath(pattern);
+        if (hasWildcard(pattern)) {
+            if (isRelative) {
+                matcher.relativeGlobs.append(QDir::cleanPath(pattern));
+            } else {
+                matcher.pathGlobs.append(QDir::cleanPath(pattern));
+            }
+        } else {
+            // Relative path prefixes are anchored at the scan root
+            matcher.paths.insert(foldCase(QDir::cleanPath(isRelative ? rootPrefix + pattern : pattern)));
+        }
+    }
+
+    excludes.compile();
+    includes.compile();
+}
+
+// Returns true if the entry matches an exclude rule and no include rule
+bool ScanRules::isExcluded(const QString& absolutePath, const QString& fileName) const
+{
+    const QString relativePath = absolutePath.startsWith(rootPrefix) ? absolutePath.mid(rootPrefix.size()) : QString();
+
+    if (!excludes.matches(absolutePath, relativePath, fileName)) {
+        return false;
+    }
+    return !includes.matches(absolutePath, relativePath, fileName);
+}
+
+void ScanRules::Matcher::compile()
+{
+    nameRegex = compileGlobs(nameGlobs);
+    pathRegex = compileGlobs(pathGlobs);
+    relativeRegex = compileGlobs(relativeGlobs);
+}
+
+// Exact names and paths are checked first since they only need a hash lookup
+bool ScanRules::Matcher::matches(const QString& absolutePath, const QString& relativePath, const QString& fileName) const
+{
+    if (!names.isEmpty() && names.contains(foldCase(fileName))) {
+        return true;
+    }
+    if (!paths.isEmpty() && paths.contains(foldCase(absolutePath))) {
+        return true;
+    }
+    if (!nameGlobs.isEmpty() && nameRegex.match(fileName).hasMatch()) {
+        return true;
+    }
+    if (!pathGlobs.isEmpty() && pathRegex.match(absolutePath).hasMatch()) {
+        return true;
+    }
+    if (!relativeGlobs.isEmpty() && !relativePath.isEmpty() && relativeRegex.match(relativePath).hasMatch()) {
+        return true;
+    }
+    return false;
+}
+
+int MetadataFilter::requiredFields() const
+{
+    int fields = NoMetadata;
+    if (minSize >= 0 || maxSize >= 0) {
+        fields |= SizeMetadata;
+    }
+    if (modifiedAfter >= 0) {
+        fields |= ModifiedMetadata;
+    }
+    return fields;
+}
+
+// Returns true if candidate satisfies every enabled predicate; candidates missing a required field are rejected
+bool MetadataFilter::accepts(const ScanCandidate& candidate) const
+{
+    if (minSize >= 0 || maxSize >= 0) {
+        if (!(candidate.fields & SizeMetadata)) {
+            return false;
+        }
+        if (minSize >= 0 && candidate.size < minSize) {
+            return false;
+        }
+        if (maxSize >= 0 && candidate.size > maxSize) {
+            return false;
+        }
+    }
+
+    if (modifiedAfter >= 0) {
+        if (!(candidate.fields & ModifiedMetadata) || candidate.modified < modifiedAfter) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+FileScanner::FileScanner(const ScanOptions& options)
+    : options(options)
+{
+}
+
+// Returns true if fileName ends with one of the selected extensions
+bool FileScanner::matchesExtension(const QString& fileName) const
+{
+    if (options.extensions.isEmpty()) {
+        return false;
+    }
+
+    const QString suffix = suffixOf(fileName);
+    return !suffix.isEmpty() && options.extensions.contains(suffix);
+}
+
+// Returns true if a file that failed the extension test should have its content checked
+// Only files without an extension or with one from sniffableExtensions() are sniffed
+bool FileScanner::shouldSniff(const QString& fileName) const
+{
+    if (!options.sniffContent) {
+        return false;
+    }
+
+    const QString suffix = suffixOf(fileName);
+    return suffix.isEmpty() || sniffableExtensions().contains(suffix);
+}
+
+// Reads the header of path unless its result is cached, and fills candidate if the content matches a selected type
+bool FileScanner::sniffFile(const QString& path, ScanCandidate& candidate) const
+{
+    candidate.path = path;
+
+    SignatureCache::Key key;
+    if (!statCandidate(candidate, options.metadataFields, &key)) {
+        return false;
+    }
+
+    int signature = -1;
+    if (!options.signatureCache || !options.signatureCache->lookup(key, signature)) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        signature = FileSignatures::classify(file.read(FileSignatures::HeaderSize));
+        if (options.signatureCache) {
+            options.signatureCache->insert(key, signature);
+        }
+    }
+
+    const QStringList extensions = FileSignatures::extensions(signature);
+    for (const QString& extension : extensions) {
+        if (options.extensions.contains(extension)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Checks the content of files the extension test could not classify, reading their headers in parallel batches
+QList<ScanCandidate> FileScanner::sniff(const QStringList& paths, const std::function<bool()>& isCanceled) const
+{
+    QList<QStringList> batches;
+    for (qsizetype i = 0; i < paths.size(); i += kSniffBatchSize) {
+        batches.append(paths.mid(i, kSniffBatchSize));
+    }
+
+    const QList<QList<ScanCandidate>> batchMatches = QtConcurrent::blockingMapped<QList<QList<ScanCandidate>>>(sniffPool(), batches,
+        [this, &isCanceled](const QStringList& batch) {
+            QList<ScanCandidate> matches;
+            for (const QString& path : batch) {
+                if (isCanceled && isCanceled()) {
+                    return matches;
+                }
+                ScanCandidate candidate;
+                if (sniffFile(path, candidate)) {
+                    matches.append(candidate);
+                }
+            }
+            return matches;
+        });
+
+    QList<ScanCandidate> mediaFiles;
+    for (const QList<ScanCandidate>& matches : batchMatches) {
+        mediaFiles.append(matches);
+    }
+    return mediaFiles;
+}
+
+// Returns true if every candidate already has the given fields, or a previous read of them failed
+bool FileScanner::hasMetadata(const QList<ScanCandidate>& candidates, int fields)
+{
+    for (const ScanCandidate& candidate : candidates) {
+        if ((fields & ~(candidate.fields | candidate.failedFields)) != NoMetadata) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads any of the given fields that candidates do not have yet, so filters can change without walking the directory again
+void FileScanner::readMetadata(QList<ScanCandidate>& candidates, int fields, const std::function<bool()>& isCanceled)
+{
+    for (ScanCandidate& candidate : candidates) {
+        if (isCanceled && isCanceled()) {
+            return;
+        }
+
+        const int missingFields = fields & ~(candidate.fields | candidate.failedFields);
+        if (missingFields != NoMetadata) {
+            statCandidate(candidate, missingFields);
+            candidate.failedFields |= missingFields & ~candidate.fields;
+        }
+    }
+}
+
+// Returns all files under directory matching the selected extensions, with the requested metadata fields filled in
+// Subdirectories are walked with an explicit stack so excluded directories, symlinks and other file systems are never opened
+// isCanceled is polled for every entry so an abandoned background scan stops as soon as the current directory read returns
+QList<ScanCandidate> FileScanner::scan(const QString& directory, const std::function<bool()>& isCanceled) const
+{
+    QList<ScanCandidate> mediaFiles;
+
+    if (options.extensions.isEmpty()) {
+        return mediaFiles;
+    }
+
+    const QString root = QDir::cleanPath(QFileInfo(directory).absoluteFilePath());
+
+#ifdef Q_OS_UNIX
+    const dev_t rootDevice = options.crossMountPoints ? 0 : deviceOf(root);
+#endif
+
+    // Only needed to break symlink cycles, so canonical paths are only resolved when symlinks are followed
+    QSet<QString> visited;
+    if (options.followSymlinks) {
+        visited.insert(QFileInfo(root).canonicalFilePath());
+    }
+
+    QStack<QString> pending;
+    pending.push(root);
+
+    // Files that need their content checked are collected during the walk and read in batches afterwards
+    QStringList unclassifiedFiles;
+
+    while (!pending.isEmpty()) {
+        if (isCanceled && isCanceled()) {
+            return {};
+        }
+
+        QDirIterator it(pending.pop(), QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            if (isCanceled && isCanceled()) {
+                return {};
+            }
+
+            it.next();
+            const QFileInfo fileInfo = it.fileInfo();
+            const QString fileName = fileInfo.fileName();
+
+            if (!fileInfo.isDir()) {
+                const bool extensionMatches = matchesExtension(fileName);
+                if ((!extensionMatches && !shouldSniff(fileName)) || options.rules.isExcluded(fileInfo.filePath(), fileName)) {
+                    continue;
+                }
+                if (!extensionMatches) {
+                    unclassifiedFiles.append(fileInfo.filePath());
+                    continue;
+                }
+
+                ScanCandidate candidate;
+                candidate.path = fileInfo.filePath();
+                if (options.metadataFields != NoMetadata) {
+#ifdef Q_OS_WIN
+                    copyMetadata(candidate, fileInfo, options.metadataFields);
+#else
+                    statCandidate(candidate, options.metadataFields);
+#endif
+                }
+                mediaFiles.append(candidate);
+                continue;
+            }
+
+            const QString dirPath = fileInfo.filePath();
+            if (options.rules.isExcluded(dirPath, fileName)) {
+                continue;
+            }
+
+            if (fileInfo.isSymLink() && !options.followSymlinks) {
+                continue;
+            }
+
+            if (!options.crossMountPoints) {
+#ifdef Q_OS_UNIX
+                if (deviceOf(dirPath) != rootDevice) {
+                    continue;
+                }
+#elif defined Q_OS_WIN
+                // Volumes mounted into a folder appear as junctions
+                if (fileInfo.isJunction()) {
+                    continue;
+                }
+#endif
+            }
+
+            if (options.followSymlinks) {
+                const QString canonicalPath = fileInfo.canonicalFilePath();
+                if (canonicalPath.isEmpty() || visited.contains(canonicalPath)) {
+                    continue;
+                }
+                visited.insert(canonicalPath);
+            }
+
+            pending.push(dirPath);
+        }
+    }
+
+    if (!unclassifiedFiles.isEmpty()) {
+        mediaFiles.append(sniff(unclassifiedFiles, isCanceled));
+    }
+
+    return mediaFiles;
+}
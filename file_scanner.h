@@ -0,0 +1,113 @@
+// file_scanner.h
+// Licensed under Apache 2.0
+
+#pragma once
+
+#include <QList>
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
+
+#include "file_signatures.h"
+
+// Include/exclude rules compiled once per scan so that each directory entry is tested with hash lookups and at most one regex match
+// Patterns without '/' match entry names ("node_modules", ".Trash*"); patterns with '/' match paths (absolute or relative to the scan root)
+// Patterns without wildcards are exact names or path prefixes; a leading '!' turns a pattern into an include rule that overrides the excludes
+class ScanRules
+{
+public:
+    ScanRules() = default;
+    ScanRules(const QStringList& patterns, const QString& rootDirectory);
+
+    bool isExcluded(const QString& absolutePath, const QString& fileName) const;
+
+private:
+    struct Matcher
+    {
+        QSet<QString> names;
+        QSet<QString> paths;
+        QStringList nameGlobs;
+        QStringList pathGlobs;
+        QStringList relativeGlobs;
+        QRegularExpression nameRegex;
+        QRegularExpression pathRegex;
+        QRegularExpression relativeRegex;
+
+        void compile();
+        bool matches(const QString& absolutePath, const QString& relativePath, const QString& fileName) const;
+    };
+
+    // Scan root with a trailing '/', stripped from entry paths before relative globs are matched
+    QString rootPrefix;
+    Matcher excludes;
+    Matcher includes;
+};
+
+enum MetadataField
+{
+    NoMetadata = 0x0,
+    SizeMetadata = 0x1,
+    ModifiedMetadata = 0x2
+};
+
+// A file that passed the extension test, along with whichever metadata fields have been read for it so far
+struct ScanCandidate
+{
+    QString path;
+    int fields = NoMetadata;
+    int failedFields = NoMetadata; // Fields a metadata read could not fill, so they are not requested again
+    qint64 size = -1;
+    qint64 modified = -1; // Milliseconds since epoch
+};
+
+// Size and modification time predicates; negative bounds are disabled
+// Age-based filters ("modified within N days") are expressed as a modifiedAfter cutoff
+struct MetadataFilter
+{
+    qint64 minSize = -1;
+    qint64 maxSize = -1;
+    qint64 modifiedAfter = -1;
+
+    int requiredFields() const;
+    bool accepts(const ScanCandidate& candidate) const;
+};
+
+struct ScanOptions
+{
+    QSet<QString> extensions;
+    ScanRules rules;
+    bool followSymlinks = false;
+    bool crossMountPoints = true;
+    int metadataFields = NoMetadata;
+    bool sniffContent = false;
+    std::shared_ptr<SignatureCache> signatureCache;
+};
+
+// Walks a source directory and collects files matching the selected extensions
+// Requested metadata fields are read for matching files only, never for files rejected by the extension test
+// With content sniffing enabled, files without an extension or with a generic one (.bin, .dat, ...) are classified by their magic bytes instead
+// Directories rejected by the scan rules, symlinks and mount point boundaries are pruned before they are opened
+class FileScanner
+{
+public:
+    explicit FileScanner(const ScanOptions& options);
+
+    QList<ScanCandidate> scan(const QString& directory, const std::function<bool()>& isCanceled = {}) const;
+    bool matchesExtension(const QString& fileName) const;
+
+    static bool hasMetadata(const QList<ScanCandidate>& candidates, int fields);
+    static void readMetadata(QList<ScanCandidate>& candidates, int fields, const std::function<bool()>& isCanceled = {});
+
+private:
+    static constexpr int kSniffBatchSize = 64;
+
+    bool shouldSniff(const QString& fileName) const;
+    bool sniffFile(const QString& path, ScanCandidate& candidate) const;
+    QList<ScanCandidate> sniff(const QStringList& paths, const std::function<bool()>& isCanceled) const;
+
+    ScanOptions options;
+};
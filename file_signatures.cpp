@@ -0,0 +1,214 @@
+// file_signatures.cpp
+// Licensed under Apache 2.0
+
+#include "file_signatures.h"
+
+#include <QList>
+
+#include <cstring>
+
+namespace {
+
+// MPEG audio frame header: the byte after the sync word holds the bitrate index (1-14 are valid) and sample rate index (3 is reserved)
+bool isValidMpegAudioFrame(const unsigned char* header, int length)
+{
+    if (length < 3) {
+        return false;
+    }
+    const int bitrateIndex = header[2] >> 4;
+    const int sampleRateIndex = (header[2] >> 2) & 0x3;
+    return bitrateIndex != 0 && bitrateIndex != 0xF && sampleRateIndex != 0x3;
+}
+
+// ADTS (raw AAC) frame header: the byte after the sync word holds the sample rate index, where only 0-12 are defined
+bool isValidAdtsFrame(const unsigned char* header, int length)
+{
+    if (length < 3) {
+        return false;
+    }
+    const int sampleRateIndex = (header[2] >> 2) & 0xF;
+    return sampleRateIndex <= 12;
+}
+
+// Patterns are written as hex bytes, with "??" for bytes that vary between files (such as RIFF chunk sizes)
+// Entries are tried in order, so more specific signatures come before ones sharing their prefix
+// Container formats that cannot be told apart by their first bytes list every extension they may belong to
+// Prefixes too short to be reliable on their own carry a validator that checks the header fields following them
+struct SignatureSpec
+{
+    const char* extensions;
+    int offset;
+    const char* bytes;
+    bool (*validate)(const unsigned char* header, int length) = nullptr;
+};
+
+const SignatureSpec kSignatureSpecs[] = {
+    // Photos
+    {".jpg .jpeg", 0, "FF D8 FF"},
+    {".png", 0, "89 50 4E 47 0D 0A 1A 0A"},
+    {".gif", 0, "47 49 46 38 ?? 61"},
+    {".tiff", 0, "49 49 2A 00"},
+    {".tiff", 0, "4D 4D 00 2A"},
+    {".webp", 0, "52 49 46 46 ?? ?? ?? ?? 57 45 42 50"},
+    // "BM", reserved bytes 6-9 zero, then a core, V1, V4 or V5 DIB header size at offset 14
+    {".bmp", 0, "42 4D ?? ?? ?? ?? 00 00 00 00 ?? ?? ?? ?? 0C 00"},
+    {".bmp", 0, "42 4D ?? ?? ?? ?? 00 00 00 00 ?? ?? ?? ?? 28 00"},
+    {".bmp", 0, "42 4D ?? ?? ?? ?? 00 00 00 00 ?? ?? ?? ?? 6C 00"},
+    {".bmp", 0, "42 4D ?? ?? ?? ?? 00 00 00 00 ?? ?? ?? ?? 7C 00"},
+
+    // Videos
+    {".avi", 0, "52 49 46 46 ?? ?? ?? ?? 41 56 49 20"},
+    // ISO base media files share the "ftyp" box, so the major brand at offset 8 decides the type
+    // Other brands (HEIC, AVIF, M4A, 3GP, CR3, ...) are left unclassified
+    {".mov", 4, "66 74 79 70 71 74 20 20"},
+    {".mp4", 4, "66 74 79 70 69 73 6F 6D"},
+    {".mp4", 4, "66 74 79 70 69 73 6F 32"},
+    {".mp4", 4, "66 74 79 70 6D 70 34 31"},
+    {".mp4", 4, "66 74 79 70 6D 70 34 32"},
+    {".mp4", 4, "66 74 79 70 61 76 63 31"},
+    {".mp4", 4, "66 74 79 70 4D 34 56 20"},
+    {".mp4", 4, "66 74 79 70 64 61 73 68"},
+    {".mov", 4, "6D 6F 6F 76"},
+    {".wmv", 0, "30 26 B2 75 8E 66 CF 11 A6 D9 00 AA 00 62 CE 6C"},
+    {".flv", 0, "46 4C 56 01"},
+    {".mkv .webm", 0, "1A 45 DF A3"},
+
+    // Documents
+    {".pdf", 0, "25 50 44 46 2D"},
+    {".doc .xls .ppt", 0, "D0 CF 11 E0 A1 B1 1A E1"},
+    {".docx .xlsx .pptx .zip", 0, "50 4B 03 04"},
+
+    // Audio
+    {".wav", 0, "52 49 46 46 ?? ?? ?? ?? 57 41 56 45"},
+    {".flac", 0, "66 4C 61 43"},
+    {".ogg", 0, "4F 67 67 53"},
+    {".mp3", 0, "49 44 33"},
+
+    // Archives
+    {".rar", 0, "52 61 72 21 1A 07"},
+    {".7z", 0, "37 7A BC AF 27 1C"},
+    {".gz", 0, "1F 8B 08"},
+    {".tar", 257, "75 73 74 61 72"},
+
+    // Bare frame sync words are only two bytes, so they are tried last and validated against the following header byte
+    {".mp3", 0, "FF FB", isValidMpegAudioFrame},
+    {".mp3", 0, "FF F3", isValidMpegAudioFrame},
+    {".mp3", 0, "FF F2", isValidMpegAudioFrame},
+    {".aac", 0, "FF F1", isValidAdtsFrame},
+    {".aac", 0, "FF F9", isValidAdtsFrame},
+};
+
+constexpr int kPatternSize = 16;
+
+// Each pattern is stored as two masked 64-bit words so every table entry is compared with the same fixed-width, branch-free test
+struct CompiledSignature
+{
+    quint64 pattern[2] = {0, 0};
+    quint64 mask[2] = {0, 0};
+    int offset = 0;
+    int length = 0;
+    bool (*validate)(const unsigned char* header, int length) = nullptr;
+    QStringList extensions;
+};
+
+CompiledSignature compileSignature(const SignatureSpec& spec)
+{
+    unsigned char pattern[kPatternSize] = {};
+    unsigned char mask[kPatternSize] = {};
+
+    const QList<QByteArray> tokens = QByteArray(spec.bytes).split(' ');
+    const int length = qMin(static_cast<int>(tokens.size()), kPatternSize);
+    for (int i = 0; i < length; ++i) {
+        if (tokens[i] != "??") {
+            pattern[i] = static_cast<unsigned char>(tokens[i].toUInt(nullptr, 16));
+            mask[i] = 0xFF;
+        }
+    }
+
+    CompiledSignature signature;
+    std::memcpy(signature.pattern, pattern, kPatternSize);
+    std::memcpy(signature.mask, mask, kPatternSize);
+    signature.offset = spec.offset;
+    signature.length = length;
+    signature.validate = spec.validate;
+    signature.extensions = QString::fromLatin1(spec.extensions).split(' ', Qt::SkipEmptyParts);
+    return signature;
+}
+
+const QList<CompiledSignature>& signatureTable()
+{
+    static const QList<CompiledSignature> table = [] {
+        QList<CompiledSignature> compiled;
+        for (const SignatureSpec& spec : kSignatureSpecs) {
+            compiled.append(compileSignature(spec));
+        }
+        return compiled;
+    }();
+    return table;
+}
+
+} // namespace
+
+// Returns the index of the first signature matching header, or -1 if none match
+int FileSignatures::classify(const QByteArray& header)
+{
+    // Zero padding lets every comparison read a full pattern width without bounds checks
+    unsigned char padded[HeaderSize + kPatternSize] = {};
+    const int headerLength = qMin(static_cast<int>(header.size()), static_cast<int>(HeaderSize));
+    std::memcpy(padded, header.constData(), headerLength);
+
+    const QList<CompiledSignature>& table = signatureTable();
+    for (int i = 0; i < table.size(); ++i) {
+        const CompiledSignature& signature = table[i];
+        if (headerLength < signature.offset + signature.length) {
+            continue;
+        }
+
+        quint64 words[2];
+        std::memcpy(words, padded + signature.offset, kPatternSize);
+        const quint64 difference = ((words[0] & signature.mask[0]) ^ signature.pattern[0])
+                                 | ((words[1] & signature.mask[1]) ^ signature.pattern[1]);
+        if (difference == 0 && (!signature.validate || signature.validate(padded, headerLength))) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Returns the extensions a classified file may belong to, or an empty list for -1
+QStringList FileSignatures::extensions(int signature)
+{
+    const QList<CompiledSignature>& table = signatureTable();
+    if (signature < 0 || signature >= table.size()) {
+        return QStringList();
+    }
+    return table[signature].extensions;
+}
+
+bool SignatureCache::Key::operator==(const Key& other) const
+{
+    return device == other.device && inode == other.inode && modified == other.modified && path == other.path;
+}
+
+size_t qHash(const SignatureCache::Key& key, size_t seed)
+{
+    return qHashMulti(seed, key.device, key.inode, key.modified, key.path);
+}
+
+bool SignatureCache::lookup(const Key& key, int& signature) const
+{
+    QReadLocker locker(&lock);
+    const auto it = entries.constFind(key);
+    if (it == entries.cend()) {
+        return false;
+    }
+    signature = it.value();
+    return true;
+}
+
+void SignatureCache::insert(const Key& key, int signature)
+{
+    QWriteLocker locker(&lock);
+    entries.insert(key, signature);
+}
@@ -0,0 +1,46 @@
+// file_signatures.h
+// Licensed under Apache 2.0
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringList>
+
+// Classifies files by their leading magic bytes, covering the formats in the default file type categories
+class FileSignatures
+{
+public:
+    // Enough to reach the "ustar" magic at offset 257, the deepest signature in the table
+    static constexpr int HeaderSize = 262;
+
+    static int classify(const QByteArray& header);
+    static QStringList extensions(int signature);
+};
+
+// Remembers classification results so a rescan never reads the same header twice; safe to share between threads
+class SignatureCache
+{
+public:
+    // Identifies a file version; inode numbers are used where available, otherwise the path
+    struct Key
+    {
+        quint64 device = 0;
+        quint64 inode = 0;
+        qint64 modified = -1;
+        QString path;
+
+        bool operator==(const Key& other) const;
+    };
+
+    bool lookup(const Key& key, int& signature) const;
+    void insert(const Key& key, int signature);
+
+private:
+    mutable QReadWriteLock lock;
+    QHash<Key, int> entries;
+};
+
+size_t qHash(const SignatureCache::Key& key, size_t seed = 0);
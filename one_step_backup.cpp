@@ -4,12 +4,17 @@
 #include "one_step_backup.h"
 
 #include <QApplication>
-#include <QDirIterator>
+#include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
+#include <QMutex>
 #include <QStandardPaths>
 #include <QStorageInfo>
 #include <QSvgWidget>
+#include <QTimer>
+
+#include <atomic>
+#include <thread>
 
 // Define a default "home" directory based on OS and Qt's implementation of standard paths
 #ifdef Q_OS_WIN
@@ -22,8 +27,48 @@
 #define DEFAULT_DIRECTORY QDir::homePath()
 #endif
 
+// How long to wait for volume discovery before giving up on a default destination
+constexpr int kVolumeProbeTimeoutMs = 3000;
+
+// Shared with the volume probe thread, which may outlive the window if a mounted drive never responds
+struct VolumeProbeState
+{
+    QMutex mutex;
+    one_step_backup* receiver = nullptr;
+};
+
+// Shared with a background scan thread, which may outlive the window if a stale mount blocks the directory walk
+struct ScanState
+{
+    std::atomic_bool canceled{false};
+    QMutex mutex;
+    one_step_backup* receiver = nullptr;
+};
+
+// Returns the root path of the first ready, writable drive other than the system drive, or an empty string if there is none
+// QStorageInfo can block for seconds on stale network mounts or sleeping disks, so this is only called off the UI thread
+static QString findExternalDrive()
+{
+    const QList<QStorageInfo> drives = QStorageInfo::mountedVolumes();
+    for (const QStorageInfo &drive : drives) {
+        // On Windows, check for drives other than C: that are ready and not read-only
+        // On macOS and Linux, check for drives other than root that are ready and not read-only
+        #ifdef Q_OS_WIN
+        if (drive.isReady() && !drive.isReadOnly() && drive.rootPath().compare("C:/", Qt::CaseInsensitive) != 0) {
+            return drive.rootPath();
+        }
+        #elif defined(Q_OS_MAC) || defined(Q_OS_LINUX)
+        if (drive.isReady() && !drive.isReadOnly() && drive.rootPath() != "/") {
+            return drive.rootPath();
+        }
+        #endif 
+    }
+    return QString();
+}
+
 one_step_backup::one_step_backup(QWidget* parent)
-    : QMainWindow(parent)
+    : QMainWindow(parent),
+      signatureCache(std::make_shared<SignatureCache>())
 {
     ui.setupUi(this);
     setWindowTitle("One Step Backup");
@@ -64,32 +109,61 @@ one_step_backup::one_step_backup(QWidget* parent)
     }
     */
     
-    // Automatically fill in destination directory as an external drive if available
-    const QList<QStorageInfo> drives = QStorageInfo::mountedVolumes();
-    QString defaultDestPath;
-    for (const QStorageInfo &drive : drives) {
-        // On Windows, check for drives other than C: that are ready and not read-only
-        // On macOS and Linux, check for drives other than root that are ready and not read-only
-        #ifdef Q_OS_WIN
-        if (drive.isReady() && !drive.isReadOnly() && drive.rootPath().compare("C:/", Qt::CaseInsensitive) != 0) {
-            defaultDestPath = drive.rootPath();
-            break; 
-        }
-        #elif defined(Q_OS_MAC) || defined(Q_OS_LINUX)
-        if (drive.isReady() && !drive.isReadOnly() && drive.rootPath() != "/") {
-            defaultDestPath = drive.rootPath();
-            break; 
-        }
-        #endif 
-        
-    }
-    if (!defaultDestPath.isEmpty()) {
-        destDirEdit->setText(defaultDestPath);
-    }
+    // Automatically fill in destination directory as an external drive if available; probing runs in the background so the window appears immediately
+    startVolumeProbe();
 
-    // File type selection
+    // File type selection and metadata filters; changing a filter updates the list without rescanning
+    QHBoxLayout* filterLayout = new QHBoxLayout();
     selectFileTypesBtn = new QPushButton("Select file types", this);
-    mainLayout->addWidget(selectFileTypesBtn);
+    minSizeCheck = new QCheckBox("Larger than", this);
+    minSizeSpin = new QSpinBox(this);
+    minSizeSpin->setRange(0, 1024 * 1024 * 1024);
+    minSizeSpin->setValue(100);
+    minSizeSpin->setSuffix(" KB");
+    maxSizeCheck = new QCheckBox("Smaller than", this);
+    maxSizeSpin = new QSpinBox(this);
+    maxSizeSpin->setRange(0, 1024 * 1024 * 1024);
+    maxSizeSpin->setValue(1024 * 1024);
+    maxSizeSpin->setSuffix(" KB");
+    modifiedWithinCheck = new QCheckBox("Modified within", this);
+    modifiedWithinSpin = new QSpinBox(this);
+    modifiedWithinSpin->setRange(1, 36500);
+    modifiedWithinSpin->setValue(30);
+    modifiedWithinSpin->setSuffix(" days");
+    modifiedSinceCheck = new QCheckBox("Modified since", this);
+    modifiedSinceEdit = new QDateEdit(QDate::currentDate().addYears(-1), this);
+    modifiedSinceEdit->setCalendarPopup(true);
+    filterLayout->addWidget(selectFileTypesBtn);
+    filterLayout->addWidget(minSizeCheck);
+    filterLayout->addWidget(minSizeSpin);
+    filterLayout->addWidget(maxSizeCheck);
+    filterLayout->addWidget(maxSizeSpin);
+    filterLayout->addWidget(modifiedWithinCheck);
+    filterLayout->addWidget(modifiedWithinSpin);
+    filterLayout->addWidget(modifiedSinceCheck);
+    filterLayout->addWidget(modifiedSinceEdit);
+    mainLayout->addLayout(filterLayout);
+
+    // Scan rules; excluded directories are skipped without being opened
+    QHBoxLayout* excludeLayout = new QHBoxLayout();
+    QLabel* excludeLabel = new QLabel("Exclude:", this);
+    excludeEdit = new QLineEdit(this);
+    excludeEdit->setText(".git; .svn; .hg; node_modules; __pycache__; .cache; .Trash*; $RECYCLE.BIN; System Volume Information; .snapshot*");
+    excludeEdit->setToolTip("Semicolon-separated names, globs or path prefixes to skip while scanning; prefix a pattern with ! to keep it");
+    excludeLayout->addWidget(excludeLabel);
+    excludeLayout->addWidget(excludeEdit);
+    mainLayout->addLayout(excludeLayout);
+
+    QHBoxLayout* scanOptionsLayout = new QHBoxLayout();
+    followSymlinksCheck = new QCheckBox("Follow symbolic links", this);
+    stayOnFileSystemCheck = new QCheckBox("Stay on source file system", this);
+    sniffContentCheck = new QCheckBox("Detect file types by content", this);
+    sniffContentCheck->setToolTip("Also match files with no extension or a generic one (such as .bin, .dat or .tmp) by reading their first bytes");
+    scanOptionsLayout->addWidget(followSymlinksCheck);
+    scanOptionsLayout->addWidget(stayOnFileSystemCheck);
+    scanOptionsLayout->addWidget(sniffContentCheck);
+    scanOptionsLayout->addStretch();
+    mainLayout->addLayout(scanOptionsLayout);
 
     // Progress bar
     progressBar = new QProgressBar(this);
@@ -101,6 +175,11 @@ one_step_backup::one_step_backup(QWidget* parent)
     fileListWidget = new QListWidget(this);
     mainLayout->addWidget(fileListWidget);
 
+    // Copy options
+    preserveStructureCheck = new QCheckBox("Preserve folder structure", this);
+    preserveStructureCheck->setToolTip("Recreate each file's folders relative to the source directory instead of copying everything into one folder");
+    mainLayout->addWidget(preserveStructureCheck);
+
     // Start button
     startBackupBtn = new QPushButton("Start Backup", this);
     mainLayout->addWidget(startBackupBtn);
@@ -110,6 +189,36 @@ one_step_backup::one_step_backup(QWidget* parent)
     connect(browseDestBtn, &QPushButton::clicked, this, &one_step_backup::browseDestinationDirectory);
     connect(selectFileTypesBtn, &QPushButton::clicked, this, &one_step_backup::openFileTypeSelection);
     connect(startBackupBtn, &QPushButton::clicked, this, &one_step_backup::startBackup);
+    connect(excludeEdit, &QLineEdit::editingFinished, this, &one_step_backup::refreshFileList);
+    connect(followSymlinksCheck, &QCheckBox::toggled, this, &one_step_backup::refreshFileList);
+    connect(stayOnFileSystemCheck, &QCheckBox::toggled, this, &one_step_backup::refreshFileList);
+    connect(sniffContentCheck, &QCheckBox::toggled, this, &one_step_backup::refreshFileList);
+    connect(minSizeCheck, &QCheckBox::toggled, this, &one_step_backup::applyMetadataFilters);
+    connect(maxSizeCheck, &QCheckBox::toggled, this, &one_step_backup::applyMetadataFilters);
+    connect(modifiedWithinCheck, &QCheckBox::toggled, this, &one_step_backup::applyMetadataFilters);
+    connect(modifiedSinceCheck, &QCheckBox::toggled, this, &one_step_backup::applyMetadataFilters);
+
+    // Value changes only matter while their filter is enabled
+    connect(minSizeSpin, &QSpinBox::valueChanged, this, [this] {
+        if (minSizeCheck->isChecked()) {
+            applyMetadataFilters();
+        }
+    });
+    connect(maxSizeSpin, &QSpinBox::valueChanged, this, [this] {
+        if (maxSizeCheck->isChecked()) {
+            applyMetadataFilters();
+        }
+    });
+    connect(modifiedWithinSpin, &QSpinBox::valueChanged, this, [this] {
+        if (modifiedWithinCheck->isChecked()) {
+            applyMetadataFilters();
+        }
+    });
+    connect(modifiedSinceEdit, &QDateEdit::dateChanged, this, [this] {
+        if (modifiedSinceCheck->isChecked()) {
+            applyMetadataFilters();
+        }
+    });
 
     QSet<QString> defaultSelection;
 
@@ -132,10 +241,55 @@ one_step_backup::one_step_backup(QWidget* parent)
     }
     
     applySelectedExtensions(defaultSelection);
-    refreshFileList();
+
+    // Defer the initial scan until the event loop is running so it never delays the first paint
+    QTimer::singleShot(0, this, &one_step_backup::refreshFileList);
 }
 
-one_step_backup::~one_step_backup() = default;
+one_step_backup::~one_step_backup()
+{
+    abandonVolumeProbe();
+    cancelScanJob();
+}
+
+// Looks for an external drive on a detached thread; a pooled thread is not used since a hung mount would then block application exit
+void one_step_backup::startVolumeProbe()
+{
+    volumeProbe = std::make_shared<VolumeProbeState>();
+    volumeProbe->receiver = this;
+
+    std::thread([state = volumeProbe] {
+        const QString drivePath = findExternalDrive();
+
+        QMutexLocker locker(&state->mutex);
+        if (one_step_backup* receiver = state->receiver) {
+            QMetaObject::invokeMethod(receiver, [receiver, drivePath] {
+                receiver->applyDefaultDestination(drivePath);
+            }, Qt::QueuedConnection);
+        }
+    }).detach();
+
+    QTimer::singleShot(kVolumeProbeTimeoutMs, this, &one_step_backup::abandonVolumeProbe);
+}
+
+// Stops the window from accepting a result from the volume probe; called on timeout and destruction
+void one_step_backup::abandonVolumeProbe()
+{
+    if (!volumeProbe) {
+        return;
+    }
+
+    QMutexLocker locker(&volumeProbe->mutex);
+    volumeProbe->receiver = nullptr;
+}
+
+// Fills in the destination directory found by the volume probe unless the user has already chosen one
+void one_step_backup::applyDefaultDestination(const QString& path)
+{
+    if (!path.isEmpty() && destDirEdit->text().isEmpty()) {
+        destDirEdit->setText(path);
+    }
+}
 
 // Display "About" dialog
 void one_step_backup::about()
@@ -217,65 +371,148 @@ void one_step_backup::openFileTypeSelection()
     }
 }
 
-// Returns true if filePath matches one of the selected extensions
-bool one_step_backup::isMediaFile(const QString& filePath) const
+// Builds the scan options from the current UI state; the exclude rules are compiled here once per scan
+ScanOptions one_step_backup::currentScanOptions(const QString& directory) const
 {
-    if (selectedExtensions.isEmpty()) {
-        return false;
-    }
+    ScanOptions options;
+    options.extensions = selectedExtensions;
+    options.rules = ScanRules(excludeEdit->text().split(';', Qt::SkipEmptyParts), directory);
+    options.followSymlinks = followSymlinksCheck->isChecked();
+    options.crossMountPoints = !stayOnFileSystemCheck->isChecked();
+    options.metadataFields = currentMetadataFilter().requiredFields();
+    options.sniffContent = sniffContentCheck->isChecked();
+    options.signatureCache = signatureCache;
+    return options;
+}
 
-    const QString suffix = QFileInfo(filePath).suffix().toLower();
-    if (suffix.isEmpty()) {
-        return false;
+// Builds the size and modification time predicates from the filter widgets; both date filters collapse into the later cutoff
+MetadataFilter one_step_backup::currentMetadataFilter() const
+{
+    MetadataFilter filter;
+    if (minSizeCheck->isChecked()) {
+        filter.minSize = static_cast<qint64>(minSizeSpin->value()) * 1024;
     }
-
-    return selectedExtensions.contains("." + suffix);
+    if (maxSizeCheck->isChecked()) {
+        filter.maxSize = static_cast<qint64>(maxSizeSpin->value()) * 1024;
+    }
+    if (modifiedWithinCheck->isChecked()) {
+        filter.modifiedAfter = QDateTime::currentDateTime().addDays(-modifiedWithinSpin->value()).toMSecsSinceEpoch();
+    }
+    if (modifiedSinceCheck->isChecked()) {
+        filter.modifiedAfter = qMax(filter.modifiedAfter, modifiedSinceEdit->date().startOfDay().toMSecsSinceEpoch());
+    }
+    return filter;
 }
 
 // Recursively finds all media files in the given directory matching the selected extensions
-// Returns absolute paths to all files matching selectedExtensions using isMediaFile()
+// Returns every file matching selectedExtensions, skipping anything rejected by the exclude rules; metadata needed by the active filters is read during the scan
 // This function is called every time a source directory is selected or file types are changed
 // Current pain point: while scanning large directories, the UI stalls until the scan is complete
-QStringList one_step_backup::findMediaFiles(const QString& directory)
+QList<ScanCandidate> one_step_backup::findMediaFiles(const QString& directory)
+{
+    return FileScanner(currentScanOptions(directory)).scan(directory);
+}
+
+// Returns the paths of candidates accepted by the current metadata filters
+QStringList one_step_backup::filterCandidates(const QList<ScanCandidate>& candidates) const
 {
+    const MetadataFilter filter = currentMetadataFilter();
+
     QStringList mediaFiles;
+    for (const ScanCandidate& candidate : candidates) {
+        if (filter.accepts(candidate)) {
+            mediaFiles.append(candidate.path);
+        }
+    }
+    return mediaFiles;
+}
 
-    if (selectedExtensions.isEmpty()) {
-        return mediaFiles;
+// Re-applies the metadata filters to the last scan without walking the directory again
+// Fields the scan did not read are fetched on a background thread, since that costs one stat per file
+void one_step_backup::applyMetadataFilters()
+{
+    // A running scan or metadata read re-applies the filters when it finishes
+    if (activeScan) {
+        showMatchingFiles();
+        return;
     }
 
-    QDirIterator it(directory, QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        const QString filePath = it.next();
-        if (isMediaFile(filePath)) {
-            mediaFiles.append(filePath);
-        }
+    const int fields = currentMetadataFilter().requiredFields();
+    if (!FileScanner::hasMetadata(scannedFiles, fields)) {
+        const QList<ScanCandidate> candidates = scannedFiles;
+        startScanJob([candidates, fields](const std::function<bool()>& isCanceled) {
+            QList<ScanCandidate> updated = candidates;
+            FileScanner::readMetadata(updated, fields, isCanceled);
+            return updated;
+        });
     }
 
-    return mediaFiles;
+    showMatchingFiles();
 }
 
 // Copies the given list of files to the destination directory
+// If preserveStructure is set, each file keeps its path relative to sourceRoot; otherwise all files are placed directly in destination
 // Returns true if all files were copied successfully, false if any error occurred
-bool one_step_backup::copyFiles(const QStringList& files, const QString& destination)
+bool one_step_backup::copyFiles(const QStringList& files, const QString& sourceRoot, const QString& destination, bool preserveStructure)
 {
     QDir destDir(destination);
     if (!destDir.exists()) {
         destDir.mkpath(".");
     }
 
+    const QDir sourceDir(sourceRoot);
+    const QString destRoot = destDir.absolutePath();
+
+    // Resolve each file's target directory up front so the directories can be created ahead of the copies
+    QStringList targetDirs;
+    targetDirs.reserve(files.size());
+    for (const QString& filePath : files) {
+        if (!preserveStructure) {
+            targetDirs.append(destRoot);
+            continue;
+        }
+        const QString relativeDir = sourceDir.relativeFilePath(QFileInfo(filePath).absolutePath());
+        targetDirs.append(QDir::cleanPath(destRoot + '/' + relativeDir));
+    }
+
+    DirectoryCache directories(destRoot);
+    if (preserveStructure) {
+        QStringList pendingDirs;
+        QSet<QString> seenDirs;
+        for (const QString& targetDir : targetDirs) {
+            if (!seenDirs.contains(targetDir)) {
+                seenDirs.insert(targetDir);
+                pendingDirs.append(targetDir);
+            }
+        }
+        directories.prefetch(pendingDirs);
+    }
+
     const int totalFiles = files.size();
     int currentFile = 0;
 
-    for (const QString& filePath : files) {
+    for (int i = 0; i < totalFiles; ++i) {
+        const QString& filePath = files.at(i);
+        const QString& targetDir = targetDirs.at(i);
         QFileInfo fileInfo(filePath);
-        QString destPath = destDir.filePath(fileInfo.fileName());
+
+        if (!directories.ensure(targetDir)) {
+            QMessageBox::warning(this, "Error", QString("Failed to create directory: %1").arg(targetDir));
+            return false;
+        }
+
+        // QDir::filePath avoids a doubled separator when targetDir is a drive root such as "E:/"
+        const QDir targetDirectory(targetDir);
+        QString destPath = targetDirectory.filePath(fileInfo.fileName());
 
         int counter = 1;
         while (QFile::exists(destPath)) {
             const QString baseName = fileInfo.baseName();
             const QString extension = fileInfo.completeSuffix();
-            destPath = destDir.filePath(QString("%1_%2.%3").arg(baseName).arg(counter).arg(extension));
+            const QString fileName = extension.isEmpty()
+                ? QString("%1_%2").arg(baseName).arg(counter)
+                : QString("%1_%2.%3").arg(baseName).arg(counter).arg(extension);
+            destPath = targetDirectory.filePath(fileName);
             ++counter;
         }
 
@@ -316,19 +553,36 @@ void one_step_backup::startBackup()
         return;
     }
 
+    // Reuse the preview scan when it is finished and matches the current source, otherwise stop it and scan here
+    const bool previewCurrent = !activeScan && scannedDirectory == sourceDir
+                             && FileScanner::hasMetadata(scannedFiles, currentMetadataFilter().requiredFields());
+    cancelScanJob();
+
+    // The list holds the backup log from here on, so the preview must not redraw it while events are processed
+    copyInProgress = true;
+    startBackupBtn->setEnabled(false);
     fileListWidget->clear();
     progressBar->setValue(0);
-    updateProgress(0, "Searching for matching files...");
 
-    const QStringList mediaFiles = findMediaFiles(sourceDir);
-    if (mediaFiles.isEmpty()) {
-        QMessageBox::information(this, "Information", "No files matching the selected file types were found in the source directory.");
-        return;
+    if (!previewCurrent) {
+        updateProgress(0, "Searching for matching files...");
+        scannedFiles = findMediaFiles(sourceDir);
+        scannedDirectory = sourceDir;
+    }
+
+    const QStringList mediaFiles = filterCandidates(scannedFiles);
+    bool succeeded = false;
+    if (!mediaFiles.isEmpty()) {
+        updateProgress(0, QString("Found %1 media files. Starting backup...").arg(mediaFiles.size()));
+        succeeded = copyFiles(mediaFiles, sourceDir, destDir, preserveStructureCheck->isChecked());
     }
 
-    updateProgress(0, QString("Found %1 media files. Starting backup...").arg(mediaFiles.size()));
+    copyInProgress = false;
+    startBackupBtn->setEnabled(true);
 
-    if (copyFiles(mediaFiles, destDir)) {
+    if (mediaFiles.isEmpty()) {
+        QMessageBox::information(this, "Information", "No files matching the selected file types were found in the source directory.");
+    } else if (succeeded) {
         QMessageBox::information(this, "Success", "Backup completed successfully!");
     }
 }
@@ -361,9 +615,80 @@ void one_step_backup::applySelectedExtensions(const QSet<QString>& extensions)
     }
 }
 
-// Refreshes the file list display based on current source directory and selected extensions
+// Starts a background rescan of the current source directory for the selected extensions, canceling any scan still running
+// The file list is refreshed when the scan finishes
 void one_step_backup::refreshFileList()
 {
+    scannedFiles.clear();
+    cancelScanJob();
+
+    const QString dir = sourceDirEdit->text();
+    scannedDirectory = dir;
+    if (!selectedExtensions.isEmpty() && !dir.isEmpty()) {
+        const ScanOptions options = currentScanOptions(dir);
+        startScanJob([options, dir](const std::function<bool()>& isCanceled) {
+            return FileScanner(options).scan(dir, isCanceled);
+        });
+    }
+
+    showMatchingFiles();
+}
+
+// Runs job on a detached thread, superseding any scan still running
+// A pooled thread is not used since a walk blocked on a stale mount would then hold up application exit
+void one_step_backup::startScanJob(const std::function<QList<ScanCandidate>(const std::function<bool()>&)>& job)
+{
+    cancelScanJob();
+
+    activeScan = std::make_shared<ScanState>();
+    activeScan->receiver = this;
+
+    std::thread([state = activeScan, job] {
+        const QList<ScanCandidate> candidates = job([&state] { return state->canceled.load(); });
+
+        QMutexLocker locker(&state->mutex);
+        if (one_step_backup* receiver = state->receiver) {
+            QMetaObject::invokeMethod(receiver, [receiver, state, candidates] {
+                receiver->onScanFinished(state, candidates);
+            }, Qt::QueuedConnection);
+        }
+    }).detach();
+}
+
+// Abandons the running scan without waiting for it; its thread stops at the next entry and its results are discarded
+void one_step_backup::cancelScanJob()
+{
+    const std::shared_ptr<ScanState> state = std::move(activeScan);
+    activeScan.reset();
+    if (!state) {
+        return;
+    }
+
+    state->canceled = true;
+    QMutexLocker locker(&state->mutex);
+    state->receiver = nullptr;
+}
+
+// Takes the results of a background scan unless it was superseded
+void one_step_backup::onScanFinished(const std::shared_ptr<ScanState>& state, const QList<ScanCandidate>& candidates)
+{
+    if (state != activeScan) {
+        return;
+    }
+
+    activeScan.reset();
+    scannedFiles = candidates;
+    applyMetadataFilters();
+}
+
+// Displays the files from the last scan that pass the current metadata filters
+void one_step_backup::showMatchingFiles()
+{
+    // A running backup owns the list; finished scans only update scannedFiles until it is done
+    if (copyInProgress) {
+        return;
+    }
+
     fileListWidget->clear();
 
     if (selectedExtensions.isEmpty()) {
@@ -377,7 +702,12 @@ void one_step_backup::refreshFileList()
         return;
     }
 
-    const QStringList mediaFiles = findMediaFiles(dir);
+    if (activeScan) {
+        fileListWidget->addItem("Searching for matching files...");
+        return;
+    }
+
+    const QStringList mediaFiles = filterCandidates(scannedFiles);
     if (mediaFiles.isEmpty()) {
         fileListWidget->addItem("No files matching the selected types were found.");
     } else {
@@ -9,6 +9,9 @@
 #include <QMessageBox>
 #include <QProgressBar>
 #include <QLabel>
+#include <QCheckBox>
+#include <QSpinBox>
+#include <QDateEdit>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QVBoxLayout>
@@ -16,10 +19,17 @@
 #include <QListWidget>
 #include <QMap>
 #include <QSet>
+#include <functional>
+#include <memory>
+#include "directory_cache.h"
+#include "file_scanner.h"
 #include "file_type_selection.h"
 #include "ui_one_step_backup.h"
 #include "ui_about.h"
 
+struct VolumeProbeState;
+struct ScanState;
+
 class one_step_backup : public QMainWindow
 {
     Q_OBJECT
@@ -39,6 +49,8 @@ private slots:
     void startBackup();
     void updateProgress(int value, const QString& message);
     void openFileTypeSelection();
+    void applyMetadataFilters();
+    void abandonVolumeProbe();
 
 private:
     // Top menu
@@ -57,18 +69,45 @@ private:
     QPushButton* browseSourceBtn;
     QPushButton* browseDestBtn;
     QPushButton* selectFileTypesBtn;
+    QCheckBox* minSizeCheck;
+    QSpinBox* minSizeSpin;
+    QCheckBox* maxSizeCheck;
+    QSpinBox* maxSizeSpin;
+    QCheckBox* modifiedWithinCheck;
+    QSpinBox* modifiedWithinSpin;
+    QCheckBox* modifiedSinceCheck;
+    QDateEdit* modifiedSinceEdit;
+    QLineEdit* excludeEdit;
+    QCheckBox* followSymlinksCheck;
+    QCheckBox* stayOnFileSystemCheck;
+    QCheckBox* sniffContentCheck;
+    QCheckBox* preserveStructureCheck;
     QPushButton* startBackupBtn;
     QProgressBar* progressBar;
     QListWidget* fileListWidget;
 
     QMap<QString, QStringList> fileTypeCategories;
     QSet<QString> selectedExtensions;
+    QList<ScanCandidate> scannedFiles;
+    QString scannedDirectory;
+    bool copyInProgress = false;
+    std::shared_ptr<SignatureCache> signatureCache;
+    std::shared_ptr<ScanState> activeScan;
+    std::shared_ptr<VolumeProbeState> volumeProbe;
 
     void initializeFileTypeCategories();
     void applySelectedExtensions(const QSet<QString>& extensions);
+    void startVolumeProbe();
+    void applyDefaultDestination(const QString& path);
     void refreshFileList();
+    void showMatchingFiles();
+    void startScanJob(const std::function<QList<ScanCandidate>(const std::function<bool()>&)>& job);
+    void cancelScanJob();
+    void onScanFinished(const std::shared_ptr<ScanState>& state, const QList<ScanCandidate>& candidates);
 
-    QStringList findMediaFiles(const QString& directory);
-    bool copyFiles(const QStringList& files, const QString& destination);
-    bool isMediaFile(const QString& filePath) const;
+    ScanOptions currentScanOptions(const QString& directory) const;
+    MetadataFilter currentMetadataFilter() const;
+    QList<ScanCandidate> findMediaFiles(const QString& directory);
+    QStringList filterCandidates(const QList<ScanCandidate>& candidates) const;
+    bool copyFiles(const QStringList& files, const QString& sourceRoot, const QString& destination, bool preserveStructure);
 };
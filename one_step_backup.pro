@@ -1,4 +1,4 @@
 CONFIG += static
-QT += svgwidgets
+QT += concurrent svgwidgets
 QTPLUGIN += qwindows  # For Windows platform plugin
 RC_FILE = app_icon.rc
\ No newline at end of file